@@ -0,0 +1,315 @@
+/*
+ * simbench - run the HealingTimeFirmware AVR image in simavr, feed it a
+ * script of serial input and pin changes, and report:
+ *
+ * - cycle counts for each instrumented function (see Bench.h in the
+ *   firmware), taken from the GPIOR0 markers it writes
+ * - peak stack use (lowest SP seen) and peak heap use (highest __brkval)
+ *
+ * Usage: simbench [-f hz] [-m mcu] [-b brkval] [-h heap_start] firmware.elf script
+ *
+ * brkval and heap_start are the RAM addresses of the __brkval and __heap_start
+ * symbols (from avr-nm). The Makefile looks these up. If they are not given,
+ * heap use is not reported.
+ *
+ * Script lines are "<ms> <action> [args...]", with ms counting simulated
+ * time from reset. '#' starts a comment. The simulation runs until an
+ * "end" event.
+ *
+ *   <ms> serial <text>             send text and a newline on UART0
+ *   <ms> pin <port><bit> <0|1>     drive an input pin, e.g. "pin D3 1"
+ *   <ms> pulse <port><bit> <width> drive a pin high for width ms
+ *   <ms> end                       stop the simulation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_ioport.h>
+
+// GPIOR0 in data space (I/O address 0x1E)
+#define GPIOR0_ADDR     0x3E
+#define MAX_EVENTS      256
+#define MAX_TEXT        32
+#define MAX_FUNCS       8
+
+// Must match the IDs in HealingTimeFirmware/Bench.h
+static const char* funcNames[MAX_FUNCS] = {
+    NULL,
+    "loop()",
+    "HealingStepper::update()",
+    "executeCmd()",
+    "onEachSecond()",
+    NULL,
+    NULL,
+    NULL,
+};
+
+typedef struct {
+    uint64_t calls;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t start;
+    int running;
+} func_stats_t;
+
+typedef enum { EvSerial, EvPin, EvEnd } event_type_t;
+
+typedef struct {
+    uint32_t ms;
+    int order;          // position in script, to keep sort stable
+    event_type_t type;
+    char port;
+    int bit;
+    int value;
+    char text[MAX_TEXT];
+} event_t;
+
+static func_stats_t stats[MAX_FUNCS];
+static event_t events[MAX_EVENTS];
+static int eventCount = 0;
+
+static void gpior0_write(struct avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+    (void)param;
+    avr->data[addr] = v;
+
+    uint8_t id = v & 0x7F;
+    if (id == 0 || id >= MAX_FUNCS) {
+        return;
+    }
+
+    func_stats_t* s = &stats[id];
+    if (!(v & 0x80)) {
+        s->start = avr->cycle;
+        s->running = 1;
+    } else if (s->running) {
+        uint64_t c = avr->cycle - s->start;
+        s->total += c;
+        if (s->calls == 0 || c < s->min) s->min = c;
+        if (c > s->max) s->max = c;
+        s->calls++;
+        s->running = 0;
+    }
+}
+
+static void uart_output(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+    (void)irq;
+    (void)param;
+    fputc(value, stdout);
+}
+
+static void add_event(event_t* e)
+{
+    if (eventCount >= MAX_EVENTS) {
+        fprintf(stderr, "simbench: too many script events\n");
+        exit(1);
+    }
+    e->order = eventCount;
+    events[eventCount++] = *e;
+}
+
+// Keeps events in time order - a pulse's falling edge may land after
+// later lines in the script.
+static int compare_events(const void* a, const void* b)
+{
+    const event_t* ea = a;
+    const event_t* eb = b;
+    if (ea->ms != eb->ms) return ea->ms < eb->ms ? -1 : 1;
+    return ea->order - eb->order;
+}
+
+static void load_script(const char* filename)
+{
+    FILE* f = fopen(filename, "r");
+    if (!f) {
+        perror(filename);
+        exit(1);
+    }
+
+    char line[128];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+
+        event_t e;
+        memset(&e, 0, sizeof(e));
+        char action[16];
+        char arg1[MAX_TEXT];
+        int arg2;
+        int n = sscanf(line, "%u %15s %31s %d", &e.ms, action, arg1, &arg2);
+        if (n <= 0) {
+            continue;
+        }
+
+        if (n >= 3 && strcmp(action, "serial") == 0) {
+            e.type = EvSerial;
+            strncpy(e.text, arg1, MAX_TEXT - 1);
+            add_event(&e);
+        } else if (n == 4 && (strcmp(action, "pin") == 0 || strcmp(action, "pulse") == 0)) {
+            e.type = EvPin;
+            e.port = arg1[0];
+            e.bit = atoi(arg1 + 1);
+            if (action[1] == 'i') {
+                e.value = arg2;
+                add_event(&e);
+            } else {
+                e.value = 1;
+                add_event(&e);
+                e.ms += arg2;
+                e.value = 0;
+                add_event(&e);
+            }
+        } else if (n >= 2 && strcmp(action, "end") == 0) {
+            e.type = EvEnd;
+            add_event(&e);
+        } else {
+            fprintf(stderr, "%s:%d: bad script line\n", filename, lineNo);
+            exit(1);
+        }
+    }
+    fclose(f);
+
+    qsort(events, eventCount, sizeof(event_t), compare_events);
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "Usage: %s [-f hz] [-m mcu] [-b brkval] [-h heap_start] firmware.elf script\n", prog);
+    exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frequency = 16000000;
+    const char* mcu = "atmega328p";
+    uint16_t brkvalAddr = 0;
+    uint16_t heapStart = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:m:b:h:")) != -1) {
+        switch (opt) {
+        case 'f': frequency = strtoul(optarg, NULL, 0); break;
+        case 'm': mcu = optarg; break;
+        // avr-nm gives RAM addresses in the 0x800000 data section
+        case 'b': brkvalAddr = strtoul(optarg, NULL, 16) & 0xFFFF; break;
+        case 'h': heapStart = strtoul(optarg, NULL, 16) & 0xFFFF; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+    }
+
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(argv[optind], &firmware) != 0) {
+        fprintf(stderr, "simbench: unable to load %s\n", argv[optind]);
+        return 1;
+    }
+    load_script(argv[optind + 1]);
+
+    avr_t* avr = avr_make_mcu_by_name(mcu);
+    if (!avr) {
+        fprintf(stderr, "simbench: unknown mcu %s\n", mcu);
+        return 1;
+    }
+    avr_init(avr);
+    avr->frequency = frequency;
+    avr_load_firmware(avr, &firmware);
+
+    // We print the UART output ourselves, so turn off simavr's echo
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+                            uart_output, NULL);
+    avr_irq_t* uartIn = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    avr_register_io_write(avr, GPIOR0_ADDR, gpior0_write, NULL);
+
+    uint16_t minSp = avr->ramend;
+    uint16_t maxBrk = 0;
+    uint64_t cyclesPerMs = frequency / 1000;
+    int nextEvent = 0;
+    int done = 0;
+    int state = cpu_Running;
+
+    while (!done && state != cpu_Done && state != cpu_Crashed) {
+        state = avr_run(avr);
+
+        uint16_t sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+        // SP is still 0 before the C runtime sets it up
+        if (sp != 0 && sp < minSp) minSp = sp;
+
+        if (brkvalAddr) {
+            uint16_t brk = avr->data[brkvalAddr] | (avr->data[brkvalAddr + 1] << 8);
+            if (brk > maxBrk) maxBrk = brk;
+        }
+
+        uint32_t ms = avr->cycle / cyclesPerMs;
+        while (nextEvent < eventCount && events[nextEvent].ms <= ms) {
+            event_t* e = &events[nextEvent++];
+            switch (e->type) {
+            case EvSerial:
+                for (const char* c = e->text; *c; c++) {
+                    avr_raise_irq(uartIn, *c);
+                }
+                avr_raise_irq(uartIn, '\n');
+                break;
+            case EvPin:
+                avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(e->port), e->bit), e->value);
+                break;
+            case EvEnd:
+                done = 1;
+                break;
+            }
+        }
+    }
+
+    if (state == cpu_Crashed) {
+        fprintf(stderr, "simbench: firmware crashed at PC 0x%04x\n", avr->pc);
+    }
+
+    printf("\n=== Cycle counts (%u Hz, %llu cycles simulated) ===\n",
+           frequency, (unsigned long long)avr->cycle);
+    printf("%-28s %10s %10s %10s %10s %10s\n", "function", "calls", "min", "avg", "max", "max us");
+    for (int i = 1; i < MAX_FUNCS; i++) {
+        if (!funcNames[i]) continue;
+        func_stats_t* s = &stats[i];
+        printf("%-28s %10llu %10llu %10llu %10llu %10.1f\n",
+               funcNames[i],
+               (unsigned long long)s->calls,
+               (unsigned long long)s->min,
+               (unsigned long long)(s->calls ? s->total / s->calls : 0),
+               (unsigned long long)s->max,
+               s->max * 1000000.0 / frequency);
+    }
+
+    printf("\n=== RAM ===\n");
+    printf("peak stack:   %u bytes (lowest SP 0x%04x)\n", avr->ramend - minSp, minSp);
+    if (brkvalAddr && heapStart) {
+        uint16_t heap = maxBrk > heapStart ? maxBrk - heapStart : 0;
+        printf("peak heap:    %u bytes\n", heap);
+        // The two peaks may not have happened at the same time, so this is
+        // a worst case
+        printf("min headroom: %d bytes between heap and stack\n",
+               (int)minSp - (int)(maxBrk > heapStart ? maxBrk : heapStart));
+    }
+
+    return state == cpu_Crashed ? 1 : 0;
+}
+
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Compare two reports from sizereport.sh, listing each symbol whose size
+# changed, and the change in totals.
+#
+# Symbol names are not unique - every F() string is a local called __c, and
+# static functions in different files may share a name - so sizes are summed
+# per name, and the number of symbols with that name is shown when it changed.
+#
+# Usage: sizecompare.sh old-report.txt new-report.txt
+
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 old-report.txt new-report.txt" 1>&2
+    exit 1
+fi
+
+awk '
+function key(    k, i) {
+    k = $1
+    for (i = 3; i <= NF; i++) k = k " " $i
+    return k
+}
+FNR == 1 { file++ }
+$1 == "total" { total[file, $2] = $3; next }
+$1 != "flash" && $1 != "ram" { next }
+file == 1 { old[key()] += $2; oldCount[key()]++; seen[key()] = 1 }
+file == 2 { new[key()] += $2; newCount[key()]++; seen[key()] = 1 }
+END {
+    for (k in seen) {
+        d = new[k] - old[k]
+        if (oldCount[k] != newCount[k]) {
+            printf "%+7d %s (x%d -> x%d)\n", d, k, oldCount[k], newCount[k]
+        } else if (d != 0) {
+            printf "%+7d %s\n", d, k
+        }
+    }
+    printf "\nflash %+d bytes (%d -> %d)\n", total[2, "flash"] - total[1, "flash"], total[1, "flash"], total[2, "flash"]
+    printf "ram   %+d bytes (%d -> %d)\n", total[2, "ram"] - total[1, "ram"], total[1, "ram"], total[2, "ram"]
+}' "$1" "$2"
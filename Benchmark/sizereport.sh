@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Per-symbol flash/RAM report for an AVR ELF file, followed by totals which are
+# checked against a budget. Exits non-zero if over budget.
+#
+# Usage: sizereport.sh firmware.elf
+#
+# Environment:
+#   AVR_NM, AVR_SIZE    tools to use (default avr-nm, avr-size)
+#   FLASH_BUDGET        bytes of flash available (default 30720 - 32 KB less
+#                       the 2 KB Nano bootloader)
+#   RAM_BUDGET          bytes of SRAM available (default 2048)
+#
+# Each symbol line is "<region> <bytes> <name>". Initialised data ("ram") also
+# takes the same number of bytes of flash for its initial value.
+
+ELF="$1"
+NM="${AVR_NM:-avr-nm}"
+SIZE="${AVR_SIZE:-avr-size}"
+FLASH_BUDGET="${FLASH_BUDGET:-30720}"
+RAM_BUDGET="${RAM_BUDGET:-2048}"
+
+if [ ! -f "$ELF" ]; then
+    echo "Usage: $0 firmware.elf" 1>&2
+    exit 1
+fi
+
+"$NM" --print-size --size-sort --demangle --radix=d "$ELF" | awk '
+{
+    size = $2 + 0
+    type = $3
+    name = $4
+    for (i = 5; i <= NF; i++) name = name " " $i
+    if (type ~ /^[TtWw]$/)      region = "flash"
+    else if (type ~ /^[Rr]$/)   region = "flash"
+    else if (type ~ /^[DdBb]$/) region = "ram"
+    else next
+    printf "%-5s %6d %s\n", region, size, name
+}' | sort -k1,1 -k2,2nr
+
+"$SIZE" -A "$ELF" | awk -v flashBudget="$FLASH_BUDGET" -v ramBudget="$RAM_BUDGET" '
+$1 == ".text" { text = $2 }
+$1 == ".data" { data = $2 }
+$1 == ".bss"  { bss = $2 }
+END {
+    flash = text + data
+    ram = data + bss
+    printf "\ntotal flash %6d / %d (%.1f%%)\n", flash, flashBudget, flash * 100.0 / flashBudget
+    printf "total ram   %6d / %d (%.1f%%) static - stack and heap come out of the rest\n", ram, ramBudget, ram * 100.0 / ramBudget
+    if (flash > flashBudget || ram > ramBudget) {
+        print "OVER BUDGET"
+        exit 1
+    }
+}'
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cycle-count instrumentation for the simavr benchmark (see ../Benchmark).
+//
+// In a BENCH build, BENCH_SCOPE(id) writes id to GPIOR0 where it is used, and
+// 0x80|id when the enclosing scope is left. The simulator watches GPIOR0 and
+// timestamps each write with the CPU cycle counter. In a normal build it
+// compiles to nothing.
+//
+// The IDs must match the names table in ../Benchmark/simbench.c
+
+const uint8_t BenchLoop                     = 1;
+const uint8_t BenchStepperUpdate            = 2;
+const uint8_t BenchExecuteCmd               = 3;
+const uint8_t BenchOnEachSecond             = 4;
+
+#ifdef BENCH
+
+#include <avr/io.h>
+
+class BenchScope {
+public:
+    BenchScope(uint8_t id) : _id(id) { GPIOR0 = _id; }
+    ~BenchScope() { GPIOR0 = 0x80 | _id; }
+
+private:
+    uint8_t _id;
+};
+
+#define BENCH_SCOPE(id) BenchScope _benchScope(id)
+
+#else
+
+#define BENCH_SCOPE(id)
+
+#endif
+
@@ -4,6 +4,74 @@
 #include "CmdReceiver.h"
 #include "Stepper1.h"
 #include "Stepper2.h"
+#include "Settings.h"
+#include "Config.h"
+#include "Bench.h"
+
+// Sequence number of the last command we accepted from the bus, and when
+static bool HaveLastSeq = false;
+static uint8_t LastSeq = 0;
+static uint32_t LastSeqMs = 0;
+static bool LastRefused = false;
+
+// Acknowledgement waiting for our slot on the back channel
+static bool AckPending = false;
+static bool AckRefused = false;
+static uint8_t AckSeq = 0;
+static uint32_t AckDueMs = 0;
+
+static const char HexDigits[] = "0123456789ABCDEF";
+
+int8_t hexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void appendSeq(String& cmd, uint8_t seq)
+{
+    cmd += '#';
+    cmd += HexDigits[seq >> 4];
+    cmd += HexDigits[seq & 0x0F];
+}
+
+int16_t stripSeq(String& cmd)
+{
+    int len = cmd.length();
+    if (len < 3 || cmd[len-3] != '#') {
+        return -1;
+    }
+    int8_t hi = hexValue(cmd[len-2]);
+    int8_t lo = hexValue(cmd[len-1]);
+    if (hi < 0 || lo < 0) {
+        return -1;
+    }
+    cmd.remove(len-3);
+    return (hi << 4) | lo;
+}
+
+// Queue an ack (or a NAK if refused) for seq. Each board waits for its own
+// slot so that acks from several Subs don't collide on the back channel.
+void scheduleAck(uint8_t seq, bool refused)
+{
+    AckPending = true;
+    AckRefused = refused;
+    AckSeq = seq;
+    AckDueMs = millis() + (BoardID.get() * AckSlotMs);
+}
+
+void updateAcks()
+{
+    if (AckPending && (int32_t)(millis() - AckDueMs) >= 0) {
+        String ack(AckRefused ? "HTN" : "HTA");
+        ack += (char)('0' + BoardID.get());
+        appendSeq(ack, AckSeq);
+        Serial.println(ack);
+        AckPending = false;
+    }
+}
 
 bool invalidCmd(String& cmd, const char* extraInfo=NULL)
 {
@@ -20,33 +88,56 @@ bool invalidCmd(String& cmd, const char* extraInfo=NULL)
     return false;
 }
 
-// All commands start "HTC" (Healing Time Command) followed by the address
-// of the device to activate.  
-//
-// The address consistes of <board><stepper>
+// All commands start "HT" (Healing Time), then the command family and the
+// address of the board(s) to act on.
 //
 // <board>      is '0' .. '9' (the ID of the board), or '*' for all.
+//
+// "HTC" commands (Healing Time Command) act on steppers:
+//
+//   HTC<board><stepper><type>
+//
 // <stepper>    is '1' or '2', or '*' for both.
+// <type>       is 'S' - spin the specified stepper(s)
+//                 'C' - calibrate the specified stepper(s)
+//
+// "HTP" commands switch all the runtime settings (see Settings.h) to a
+// named profile, and save them:
+//
+//   HTP<board><profile>
+//
+// <profile>    is 'P' - proper (production) values
+//                 'T' - testing (commissioning): fast motors, time warp
+//
+// "HTV" commands set and save one runtime setting:
+//
+//   HTV<board><key><value>
+//
+// <key>        is one of the keys listed in Settings.h
+// <value>      is a decimal number
 //
-// Finally, the last character of a command is the command type:
-// 'S' - spin the specified stepper(s)
-// 'C' - calibrate the specified stepper(s)
+// The Dom appends a sequence number "#XX" (two hex digits) when it sends a
+// command over the bus. Each addressed Sub replies "HTA<board>#XX" so the
+// Dom knows the command arrived. If an HTP or HTV command is refused (unknown
+// profile or key, or a value out of range) the Sub replies "HTN<board>#XX"
+// instead, so the Dom can report it. Commands without a sequence number are
+// still accepted, but are not acknowledged.
 //
 // Example:
 //
-// HTC21S - spin board 2, stepper 1
-// HTC**S - spin all boards, all steppers
-// HTC**C - calibrate all boards, all steppers
+// HTC21S    - spin board 2, stepper 1
+// HTC**S    - spin all boards, all steppers
+// HTC**C    - calibrate all boards, all steppers
+// HTC**S#3F - spin all boards, all steppers, sequence number 0x3F
+// HTA2#3F   - board 2 acknowledges sequence number 0x3F
+// HTN2#3F   - board 2 refuses sequence number 0x3F
+// HTP*T     - all boards switch to the testing profile
+// HTV*S1000 - all boards set stepper speed to 1000
 
-bool executeCmd(String& cmd)
+bool stepperCmd(String& cmd)
 {
-    if (!cmd.startsWith("HTC") || cmd.length() != 6) {
-        return false;
-    }
-
-    char boardId = cmd[3];
-    if (boardId != '*' && (boardId < '0' || boardId > '9')) {
-        return invalidCmd(cmd, "boardId");
+    if (cmd.length() != 6) {
+        return invalidCmd(cmd, "length");
     }
 
     char stepperId = cmd[4];
@@ -54,15 +145,6 @@ bool executeCmd(String& cmd)
         return invalidCmd(cmd, "stepperId");
     }
 
-    uint8_t firstBoard, lastBoard;
-    if (boardId == '*') {
-        firstBoard = 0;
-        lastBoard = 9;
-    } else {
-        firstBoard = boardId - '0';
-        lastBoard = boardId - '0';
-    }
-
     uint8_t firstStepper, lastStepper;
     if (stepperId == '*') {
         firstStepper = 1;
@@ -73,37 +155,127 @@ bool executeCmd(String& cmd)
     }
 
     bool ran = false;
-    for (uint8_t b = firstBoard; b <= lastBoard; b++) {
-        for (uint8_t s = firstStepper; s <= lastStepper; s++) {
-            switch (cmd[5]) {
-            case 'C':
-                if (b == BoardID.get()) {
-                    if (s == 1) {
-                        Stepper1.calibrate();
-                        ran = true;
-                    } else if (s == 2) {
-                        Stepper2.calibrate();
-                        ran = true;
-                    }
-                }
-                break;
-            case 'S':
-                if (b == BoardID.get()) {
-                    if (s == 1) {
-                        Stepper1.spin();
-                        ran = true;
-                    } else if (s == 2) {
-                        Stepper2.spin();
-                        ran = true;
-                    }
-                }
-                break;
-            default:
-                break;
+    for (uint8_t s = firstStepper; s <= lastStepper; s++) {
+        switch (cmd[5]) {
+        case 'C':
+            if (s == 1) {
+                Stepper1.calibrate();
+                ran = true;
+            } else if (s == 2) {
+                Stepper2.calibrate();
+                ran = true;
+            }
+            break;
+        case 'S':
+            if (s == 1) {
+                Stepper1.spin();
+                ran = true;
+            } else if (s == 2) {
+                Stepper2.spin();
+                ran = true;
             }
+            break;
+        default:
+            break;
         }
     }
 
     return ran;
 }
 
+bool profileCmd(String& cmd)
+{
+    if (cmd.length() != 5 || !applyProfile(cmd[4])) {
+        return invalidCmd(cmd, "profile");
+    }
+    return true;
+}
+
+bool settingCmd(String& cmd)
+{
+    if (cmd.length() < 6) {
+        return invalidCmd(cmd, "length");
+    }
+    for (uint8_t i = 5; i < cmd.length(); i++) {
+        if (cmd[i] < '0' || cmd[i] > '9') {
+            return invalidCmd(cmd, "value");
+        }
+    }
+    if (!setSetting(cmd[4], cmd.substring(5).toInt())) {
+        return invalidCmd(cmd, "setting");
+    }
+    return true;
+}
+
+bool executeCmd(String& cmd, bool acknowledge)
+{
+    BENCH_SCOPE(BenchExecuteCmd);
+
+    int16_t seq = stripSeq(cmd);
+
+    if (!cmd.startsWith("HT") || cmd.length() < 5) {
+        return false;
+    }
+
+    char family = cmd[2];
+    if (family != 'C' && family != 'P' && family != 'V') {
+        return false;
+    }
+
+    char boardId = cmd[3];
+    if (boardId != '*' && (boardId < '0' || boardId > '9')) {
+        return invalidCmd(cmd, "boardId");
+    }
+
+    if (boardId != '*' && boardId - '0' != BoardID.get()) {
+        return false;
+    }
+
+    if (acknowledge && seq >= 0) {
+        // Only a retry if it's inside the Dom's retry window - after that the
+        // same number is a new command (the Dom was reset, or the sequence
+        // wrapped).
+        if (HaveLastSeq && seq == LastSeq && millis() - LastSeqMs < DuplicateWindowMs) {
+            debugId();
+            DB(F("duplicate command: '"));
+            DB(cmd);
+            DBLN('\'');
+            // Reply again - our previous reply may have been lost
+            scheduleAck(seq, LastRefused);
+            return false;
+        }
+        HaveLastSeq = true;
+        LastSeq = seq;
+        LastSeqMs = millis();
+    }
+
+    bool ok = false;
+    switch (family) {
+    case 'C':
+        ok = stepperCmd(cmd);
+        break;
+    case 'P':
+        ok = profileCmd(cmd);
+        break;
+    case 'V':
+        ok = settingCmd(cmd);
+        break;
+    default:
+        break;
+    }
+
+    if (acknowledge && seq >= 0) {
+        // A spin which didn't run because the motor is busy was still
+        // delivered - only refused settings get a NAK
+        LastRefused = !ok && isSettingCmd(cmd);
+        scheduleAck(seq, LastRefused);
+    }
+
+    return ok;
+}
+
+bool isSettingCmd(const String& cmd)
+{
+    return cmd.startsWith("HTP") || cmd.startsWith("HTV");
+}
+
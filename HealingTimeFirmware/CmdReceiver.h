@@ -2,7 +2,26 @@
 
 #include <Arduino.h>
 
-const uint8_t MaxCmdLength = 8;
+const uint8_t MaxCmdLength = 16;
 
-bool executeCmd(String& cmd);
+// Execute a command. If acknowledge is true (i.e. the command came in over
+// the bus from the Dom), sequenced commands which address this board are
+// acknowledged (or refused, for settings which could not be applied), and
+// duplicates (retries of a command we already have) are dropped without
+// being executed again.
+// Returns true if the command was run successfully.
+bool executeCmd(String& cmd, bool acknowledge=false);
+
+// Is cmd an HTP or HTV command (one which changes settings)?
+bool isSettingCmd(const String& cmd);
+
+// Send any acknowledgement which is due - run frequently
+void updateAcks();
+
+// Append "#XX" sequence suffix to cmd
+void appendSeq(String& cmd, uint8_t seq);
+
+// If cmd ends with a "#XX" sequence suffix, remove it and return the
+// sequence number, else return -1 and leave cmd unmodified.
+int16_t stripSeq(String& cmd);
 
@@ -0,0 +1,169 @@
+#include <MutilaDebug.h>
+
+#include "CmdSender.h"
+#include "CmdReceiver.h"
+#include "BoardID.h"
+#include "Config.h"
+
+CommandSender CmdSender;
+
+CommandSender::CommandSender() :
+    _seq(0),
+    _pending(false),
+    _timeSensitive(false),
+    _waitingFor(0),
+    _refusedBy(0),
+    _attempts(0),
+    _firstSentMs(0),
+    _lastSentMs(0),
+    _sentCount(0),
+    _deliveredCount(0),
+    _failedCount(0),
+    _refusedCount(0),
+    _retryCount(0),
+    _lastLatencyMs(0),
+    _maxLatencyMs(0)
+{
+}
+
+void CommandSender::begin()
+{
+    // Start somewhere random so a Dom reset doesn't re-use the sequence
+    // number the Subs last saw (they'd drop it as a duplicate)
+    _seq = random(0, 256);
+}
+
+void CommandSender::send(String cmd)
+{
+    stripSeq(cmd);
+
+    char family = cmd.length() >= 5 && cmd.startsWith("HT") ? cmd[2] : 0;
+    if (family != 'C' && family != 'P' && family != 'V') {
+        // Not something the Subs will ack - just pass it on
+        Serial.println(cmd);
+        return;
+    }
+
+    if (_pending) {
+        debugId();
+        DBLN(F("abandoning undelivered command"));
+        finish(false);
+    }
+
+    // Work out which Subs should ack. We execute locally, so we never
+    // wait for our own board.
+    _waitingFor = 0;
+    _refusedBy = 0;
+    char boardId = cmd[3];
+    for (uint8_t b = 0; b < BoardCount; b++) {
+        if (b != BoardID.get() && (boardId == '*' || boardId - '0' == b)) {
+            _waitingFor |= (1 << b);
+        }
+    }
+
+    _cmd = cmd;
+    appendSeq(_cmd, ++_seq);
+    Serial.println(_cmd);
+
+    if (_waitingFor == 0) {
+        return;
+    }
+
+    _pending = true;
+    _timeSensitive = family == 'C' && cmd.length() == 6 && cmd[5] == 'S';
+    _attempts = 1;
+    _firstSentMs = millis();
+    _lastSentMs = _firstSentMs;
+    ++_sentCount;
+}
+
+bool CommandSender::ack(String line)
+{
+    int16_t seq = stripSeq(line);
+    bool refused = line.startsWith("HTN");
+    if ((!refused && !line.startsWith("HTA")) || line.length() != 4 || seq < 0) {
+        return false;
+    }
+
+    uint8_t board = line[3] - '0';
+    if (!_pending || seq != _seq || board >= BoardCount) {
+        // late ack for an old command, or garbage
+        return false;
+    }
+
+    if (refused) {
+        // Tell the operator - the boards' settings no longer match
+        Serial.print(F("board "));
+        Serial.print(board);
+        Serial.print(F(" refused "));
+        Serial.println(_cmd);
+        _refusedBy |= (1 << board);
+    }
+
+    _waitingFor &= ~(1 << board);
+    if (_waitingFor == 0) {
+        finish(true);
+    }
+    return true;
+}
+
+void CommandSender::update()
+{
+    if (!_pending || millis() - _lastSentMs < AckTimeoutMs) {
+        return;
+    }
+
+    if (_attempts > (_timeSensitive ? SpinMaxRetries : CmdMaxRetries)) {
+        finish(false);
+        return;
+    }
+
+    debugId();
+    DB(F("RESENDING COMMAND: "));
+    DBLN(_cmd);
+    Serial.println(_cmd);
+    ++_attempts;
+    ++_retryCount;
+    _lastSentMs = millis();
+}
+
+void CommandSender::finish(bool delivered)
+{
+    _pending = false;
+    if (delivered && _refusedBy) {
+        ++_refusedCount;
+    } else if (delivered) {
+        ++_deliveredCount;
+        _lastLatencyMs = millis() - _firstSentMs;
+        if (_lastLatencyMs > _maxLatencyMs) {
+            _maxLatencyMs = _lastLatencyMs;
+        }
+    } else {
+        ++_failedCount;
+        debugId();
+        DB(F("delivery failed: "));
+        DB(_cmd);
+        DB(F(" missing=0x"));
+        DBLN(_waitingFor, HEX);
+    }
+}
+
+void CommandSender::printMetrics()
+{
+    Serial.print(F("HTM sent="));
+    Serial.print(_sentCount);
+    Serial.print(F(" delivered="));
+    Serial.print(_deliveredCount);
+    Serial.print(F(" failed="));
+    Serial.print(_failedCount);
+    Serial.print(F(" refused="));
+    Serial.print(_refusedCount);
+    Serial.print(F(" retries="));
+    Serial.print(_retryCount);
+    Serial.print(F(" latency="));
+    Serial.print(_lastLatencyMs);
+    Serial.print(F("ms max="));
+    Serial.print(_maxLatencyMs);
+    Serial.println(F("ms"));
+}
+
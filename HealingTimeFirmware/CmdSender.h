@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*! The CommandSender is used by the Dom to broadcast commands on the bus
+ *  and make sure they get to the Subs.
+ *
+ *  Each command is given a sequence number (see CmdReceiver.cpp). The Subs
+ *  addressed by the command acknowledge it. If any ack is still missing
+ *  after AckTimeoutMs, the command is sent again with the same sequence
+ *  number (Subs which already have it drop the duplicate), up to
+ *  CmdMaxRetries times. Spin commands get at most SpinMaxRetries, which is
+ *  derived from SpinDeliveryBudgetMs so the last retry still goes out in time.
+ *
+ *  Only one command is tracked at a time. Sending a new command abandons
+ *  the previous one if it is still waiting for acks.
+ */
+class CommandSender {
+public:
+    // Constructor
+    CommandSender();
+
+    // Initialise the object (pick a starting sequence number). Call after
+    // the random number generator has been seeded.
+    void begin();
+
+    // Allocate timeslice - run frequently
+    // Re-sends the current command if acks are overdue
+    void update();
+
+    // Broadcast cmd on the bus and start waiting for acks
+    void send(String cmd);
+
+    // Handle an ack ("HTA<board>#XX") or refusal ("HTN<board>#XX") line
+    // from a Sub. Refusals are reported on serial.
+    // \return true if the reply was for the current command
+    bool ack(String line);
+
+    // Print delivery metrics to serial
+    void printMetrics();
+
+private:
+    // Stop tracking the current command and record the outcome
+    void finish(bool delivered);
+
+private:
+    String _cmd;
+    uint8_t _seq;
+    bool _pending;
+    bool _timeSensitive;
+    uint16_t _waitingFor;       // bit per board we still need an ack from
+    uint16_t _refusedBy;        // bit per board which refused the command
+    uint8_t _attempts;
+    uint32_t _firstSentMs;
+    uint32_t _lastSentMs;
+
+    // Metrics
+    uint16_t _sentCount;
+    uint16_t _deliveredCount;
+    uint16_t _failedCount;
+    uint16_t _refusedCount;
+    uint16_t _retryCount;
+    uint16_t _lastLatencyMs;
+    uint16_t _maxLatencyMs;
+
+};
+
+extern CommandSender CmdSender;
+
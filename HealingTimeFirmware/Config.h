@@ -3,22 +3,29 @@
 #include <stdint.h>
 #include <Arduino.h>
 
+// Runtime settings. These may be changed over the command bus and are kept
+// in EEPROM (see Settings.h). The *Proper* values are the defaults, used until
+// a setting has been saved.
+
 // Day/night times
-//const uint32_t WakeSeconds                  = (8  * 3600L);  // 08:00 - first trigger *Proper*
-//const uint32_t SleepSeconds                 = (19 * 3600L);  // 19:00 - last trigger *Proper*
-const uint32_t WakeSeconds                  = (7.75  * 3600L); // 07:45 - first trigger
-const uint32_t SleepSeconds                 = (19.75 * 3600L); // 19:45 - last trigger
+const uint32_t ProperWakeSeconds            = (7.75  * 3600L); // 07:45 - first trigger
+const uint32_t ProperSleepSeconds           = (19.75 * 3600L); // 19:45 - last trigger
 
 // Stepper parameters
-const uint16_t StepperNormalSpeed           = 300;    // *Proper* values (30 second rotation)
-const uint16_t StepperNormalAcceleration    = 100;
-//const uint16_t StepperNormalSpeed           = 1000;      // *Testing*
-//const uint16_t StepperNormalAcceleration    = 2000;      // *Testing*
+const uint16_t ProperStepperSpeed           = 300;    // 30 second rotation
+const uint16_t ProperStepperAcceleration    = 100;
+const uint16_t TestingStepperSpeed          = 1000;
+const uint16_t TestingStepperAcceleration   = 2000;
+
+const uint32_t ProperPeriod1                = 450;  // 450 seconds = 7.5 mins
+const uint32_t ProperPeriod2                = 1800; // 1800 seconds = 30 mins
 
-//const uint32_t Period1                      = 450;  // 450 seconds = 7.5 mins *Proper*
-//const uint32_t Period2                      = 1800; // 1800 seconds = 30 mins *Proper*
-const uint32_t Period1                      = 450;  // 450 seconds = 7.5 mins *Testing*
-const uint32_t Period2                      = 1800; // 1800 seconds = 30 mins *Testing*
+// The Dom runs its schedule this many times faster than real time. The
+// *Testing* profile runs a full day (07:45 - 19:45, skipping the night) in
+// 24 minutes.
+const uint8_t ProperTimeWarp                = 1;
+const uint8_t TestingTimeWarp               = 30;
+const uint8_t MaxTimeWarp                   = 60;
 
 /////////////////////////////////////////////////////////////////////////////////
 // Don't modify stuff below here if you want to stay sane.
@@ -33,9 +40,32 @@ const int32_t StartupFudge                  = 1000;
 const uint32_t SerialBaud                   = 9600;
 //const uint32_t SerialBaud                   = 115200;
 
+// Command bus delivery. The Dom appends a sequence number to each command,
+// and addressed Subs acknowledge it. Subs stagger their acks by board ID so
+// they don't talk over one another on the shared back channel.
+const uint8_t BoardCount                    = 4;      // Boards 0 .. BoardCount-1
+const uint16_t AckSlotMs                    = 20;     // per-board ack delay
+const uint16_t AckTimeoutMs                 = 120;    // resend if not all acks by now
+const uint8_t CmdMaxRetries                 = 3;
+// A Sub treats a repeated sequence number as a retry only within this long of
+// the original - the last retry goes out CmdMaxRetries * AckTimeoutMs after it.
+const uint16_t DuplicateWindowMs            = (CmdMaxRetries + 1) * AckTimeoutMs;
+// Spins are time-sensitive: the Dom starts its own motors straight away, and a
+// wheel which starts late on another board is visibly out of step. This is the
+// most a Sub's motor start may lag the Dom's, so every spin retry must go out
+// within this long of the first send. Retry n goes out n * AckTimeoutMs after
+// the first send, so with the values here spins get 2 retries, not 3.
+const uint16_t SpinDeliveryBudgetMs         = 300;
+const uint8_t SpinMaxRetries                = (SpinDeliveryBudgetMs - 1) / AckTimeoutMs < CmdMaxRetries ?
+                                              (SpinDeliveryBudgetMs - 1) / AckTimeoutMs : CmdMaxRetries;
+
 // The address of the clock device (from DS3231.cpp)
 const int RtcAddress                        = 0x68;
 
+// In a BENCH build there is no RTC - the clock starts at this time at reset.
+// 2026-01-01 09:29:45, so the first full spin is 15 seconds after reset.
+const uint32_t BenchStartUnix               = 1767259785;
+
 const uint8_t HeartbeatPin                  = 13;
 const uint8_t HallSensorBank1Pin            = 3;
 const uint8_t HallSensorBank2Pin            = 4;
@@ -48,6 +78,10 @@ const int32_t SetupSteps                    = 200000; // TODO: remove (deprecate
 const int32_t CalibrateSteps                = 200000;
 const int8_t CalibrationSpins               = 1;
 
+// Largest calibrated Full Spin we accept. Also used to check that the schedule
+// leaves time for a spin to finish before the next trigger.
+const int32_t MaxFullSpinSteps              = 10000;
+
 const uint8_t StepperHalfStep               = 8;
 const uint16_t StepperCalibrateSpeed        = 1000;
 const uint16_t StepperCalibrateAcceleration = 2000;
@@ -4,6 +4,8 @@
 #include "HealingStepper.h"
 #include "Config.h"
 #include "BoardID.h"
+#include "Settings.h"
+#include "Bench.h"
 
 HealingStepper::HealingStepper(uint8_t id, uint8_t interface, uint8_t pin1, uint8_t pin2, uint8_t pin3, uint8_t pin4, bool enable, uint8_t hallPin, bool controlHeartbeat) :
     AccelStepper(interface, pin1, pin2, pin3, pin4, enable),
@@ -14,7 +16,7 @@ HealingStepper::HealingStepper(uint8_t id, uint8_t interface, uint8_t pin1, uint
                 0),    // default (if loaded value out of min/max)
     _fullSpin((id * (sizeof(int32_t) + sizeof(int32_t))), // offset in EEPROM
               6000,  // min
-              10000, // max
+              MaxFullSpinSteps, // max
               8000), // default (if loaded value out of min/max)
     _mode(HealingStepper::CalibrateSpin),
     _id(id),
@@ -67,8 +69,8 @@ void HealingStepper::setMode(HealingStepper::Mode mode)
     case HealingStepper::Spinning:
         DBLN(F("Spinning)"));
         //if (_controlHeartbeat) { HeartBeat.setCustomMode(950, 50); }
-        setMaxSpeed(StepperNormalSpeed);
-        setAcceleration(StepperNormalAcceleration);
+        setMaxSpeed(StepperNormalSpeed.get());
+        setAcceleration(StepperNormalAcceleration.get());
         moveTo(_fullSpin.get());
         _sensorCount = 0;
         break;
@@ -128,6 +130,8 @@ bool HealingStepper::isEnabled()
 
 void HealingStepper::update()
 {
+    BENCH_SCOPE(BenchStepperUpdate);
+
     // give time-slice to hall sensor
     _hallSensor.update();
 
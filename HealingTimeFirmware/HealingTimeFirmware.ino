@@ -11,6 +11,9 @@
 #include "Button.h"
 #include "BoardID.h"
 #include "CmdReceiver.h"
+#include "CmdSender.h"
+#include "Settings.h"
+#include "Bench.h"
 
 #include "Config.h"
 
@@ -19,6 +22,7 @@ uint32_t LastOutputMs = 0;
 uint32_t PrevUnix = 0;
 long StepperTravel = 8210;
 bool DomMode = false;
+uint32_t WarpDaySec = 0;
 char cmdBuffer[MaxCmdLength];
 uint8_t cmdBufferIdx = 0;
 
@@ -43,9 +47,15 @@ void sendCmd(String cmd)
     debugId();
     DB(F("SENDING COMMAND: "));
     DBLN(cmd);
-    executeCmd(cmd); // execute locally
+    bool ran = executeCmd(cmd); // execute locally
     if (DomMode) {
-        Serial.println(cmd);
+        if (!ran && isSettingCmd(cmd) && cmd.length() > 3 && (cmd[3] == '*' || cmd[3] - '0' == BoardID.get())) {
+            // We refused it - don't set the Subs to something we won't use
+            Serial.print(F("refused "));
+            Serial.println(cmd);
+            return;
+        }
+        CmdSender.send(cmd);
     }
 }
 
@@ -56,7 +66,7 @@ void onEachPeriod1()
 
     if (DomMode) { // redundant since only Dom can have this function called...
         // Choose a board at random
-        char board = '0' + random(0, 4);
+        char board = '0' + random(0, BoardCount);
         char stepper = '1' + random(0, 2);
         String cmd("HTC");
         cmd += board;
@@ -89,21 +99,78 @@ String getTimestamp(DateTime& now)
     return s;
 }
 
+// Decide if the system it in the "out of hours" period.
+bool isActiveTime(uint32_t daySec)
+{
+    return daySec >= WakeSeconds.get() && daySec <= SleepSeconds.get();
+}
+
+// Decides what other events need to be triggered based on the time of
+// day (which may be warped - see onEachSecond). Returns true if an event
+// was triggered.
+bool runSchedule(uint32_t daySec)
+{
+    if (!isActiveTime(daySec)) {
+        return false;
+    }
+
+    // Higher intervals take precendence when both are true...
+    if (daySec % Period2.get() == 0) {
+        onEachPeriod2();
+        return true;
+    } else if (daySec % Period1.get() == 0) {
+        onEachPeriod1();
+        return true;
+    }
+    return false;
+}
+
+// The next second of the warped day. The night is skipped - after
+// SleepSeconds we go straight to WakeSeconds - so a whole day of activity
+// takes (SleepSeconds - WakeSeconds) / TimeWarp real seconds.
+uint32_t nextWarpSec(uint32_t daySec)
+{
+    daySec = (daySec + 1) % 86400L;
+    if (!isActiveTime(daySec)) {
+        daySec = WakeSeconds.get();
+    }
+    return daySec;
+}
+
 // This function is triggered once for every RTC second that passes.
-// It devices what other events need to be triggered based on the time 
-// of day.
+// When TimeWarp is more than 1, it runs the schedule that many seconds
+// per real second, starting from the wake time of a virtual day and
+// skipping the night.
 void onEachSecond(DateTime& now)
 {
+    BENCH_SCOPE(BenchOnEachSecond);
+
     // Number of seconds sice the beginning of the day
     uint32_t daySec = (now.hour() * 3600L) + (now.minute() * 60L) + now.second();
 
-    // Decide if the system it in the "out of hours" period.
-    bool activeTime = daySec >= WakeSeconds && daySec <= SleepSeconds;
+    if (TimeWarp.get() > 1) {
+        if (!Warping) {
+            WarpDaySec = (WakeSeconds.get() + 86399L) % 86400L;
+            Warping = true;
+        }
+    } else {
+        Warping = false;
+    }
+
+    // The first schedule second we're about to run
+    uint32_t scheduleSec = Warping ? nextWarpSec(WarpDaySec) : daySec;
 
     debugId();
     DB("on=");
-    DB(activeTime);
+    DB(isActiveTime(scheduleSec));
     DB(' ');
+    if (Warping) {
+        DB("warp=");
+        DB(TimeWarp.get());
+        DB(" day=");
+        DB(scheduleSec);
+        DB(' ');
+    }
     DB(now.year(), DEC);
     DB('-');
     if (now.month() < 10) DB('0'); DB(now.month(), DEC);
@@ -118,9 +185,20 @@ void onEachSecond(DateTime& now)
     DB(" unix=");
     DBLN(now.unixtime());
 
-    // Higher intervals take precendence when both are true...
-    if (daySec % Period2 == 0 && activeTime) onEachPeriod2();
-    else if (daySec % Period1 == 0 && activeTime) onEachPeriod1();
+    if (Warping) {
+        // Settings are checked so this shouldn't happen, but never trigger
+        // more than once per real second - the previous command would be
+        // abandoned before its acks arrive.
+        bool triggered = false;
+        for (uint8_t i = 0; i < TimeWarp.get(); i++) {
+            WarpDaySec = nextWarpSec(WarpDaySec);
+            if (!triggered) {
+                triggered = runSchedule(WarpDaySec);
+            }
+        }
+    } else {
+        runSchedule(daySec);
+    }
 }
 
 void resetCmd() 
@@ -131,7 +209,8 @@ void resetCmd()
 
 void appendCmd(char c)
 {
-    if (cmdBufferIdx < MaxCmdLength) {
+    // leave room for the terminating null
+    if (cmdBufferIdx < MaxCmdLength - 1) {
         cmdBuffer[cmdBufferIdx++] = c;
     }
 }
@@ -145,7 +224,19 @@ void handleSerialInput()
         case '\n':
         case '\r':
             cmd = cmdBuffer;
-            sendCmd(cmd);
+            if (!DomMode) {
+                // commands from the Dom
+                executeCmd(cmd, true);
+            } else if (cmd.startsWith("HTA") || cmd.startsWith("HTN")) {
+                // acks and refusals from the Subs
+                CmdSender.ack(cmd);
+            } else if (cmd == "HTM") {
+                CmdSender.printMetrics();
+            } else if (cmd == "HTL") {
+                printSettings();
+            } else if (cmd.length() > 0) {
+                sendCmd(cmd);
+            }
             resetCmd();
             break;
         default:
@@ -178,7 +269,15 @@ void setup()
     Stepper2.begin();
 
     // use the presence or absence of the RTC to decide if we're the dom or a sub
+#if defined(BENCH_SUB)
+    // Bench the Sub side: receiving, de-duplicating and acking commands
+    DomMode = false;
+#elif defined(BENCH)
+    // No RTC in the simulator - run as the Dom on the bench clock
+    DomMode = true;
+#else
     DomMode = testForRTC();
+#endif
     debugId();
     if (DomMode) {
         DBLN(F("I AM THE DOM!"));
@@ -187,6 +286,7 @@ void setup()
     }
 
     resetCmd();
+    CmdSender.begin();
 
     debugId();
     DBLN(F("E:setup\n"));
@@ -194,6 +294,8 @@ void setup()
 
 void loop()
 {
+    BENCH_SCOPE(BenchLoop);
+
     // Give a timeslice to each system component
 
     Button.update();
@@ -201,6 +303,10 @@ void loop()
     Stepper1.update();
     Stepper2.update();
     handleSerialInput();
+    updateAcks();
+    if (DomMode) {
+        CmdSender.update();
+    }
 
     if (Button.tapped()) {
         sendCmd("HTC**C");
@@ -210,7 +316,11 @@ void loop()
     // Millis()) so that if Millis is drifting relative to the RTC, we 
     // can be sure we'll never miss a second.
     if (DoEvery(500, LastOutputMs)) {
+#ifdef BENCH
+        DateTime now(BenchStartUnix + (millis() / 1000));
+#else
         DateTime now = Clock.now();
+#endif
         if (now.unixtime() != PrevUnix) {
             onEachSecond(now);
             PrevUnix = now.unixtime();
@@ -0,0 +1,160 @@
+#include <MutilaDebug.h>
+
+#include "Settings.h"
+#include "BoardID.h"
+#include "Config.h"
+
+// EEPROM offsets start after the stepper calibration values
+PersistentSetting<uint16_t> StepperNormalSpeed(32,    // EEPROM offset
+                                               50,    // min
+                                               2000,  // max
+                                               ProperStepperSpeed);
+PersistentSetting<uint16_t> StepperNormalAcceleration(34,
+                                                      10,
+                                                      5000,
+                                                      ProperStepperAcceleration);
+PersistentSetting<uint32_t> Period1(36, 10, 86400, ProperPeriod1);
+PersistentSetting<uint32_t> Period2(40, 10, 86400, ProperPeriod2);
+PersistentSetting<uint32_t> WakeSeconds(44, 0, 86399, ProperWakeSeconds);
+PersistentSetting<uint32_t> SleepSeconds(48, 0, 86399, ProperSleepSeconds);
+PersistentSetting<uint8_t> TimeWarp(52, 1, MaxTimeWarp, ProperTimeWarp);
+
+bool Warping = false;
+
+// Check the range before narrowing to T, so e.g. 70000 doesn't wrap into
+// range of a uint16_t setting.
+template <class T>
+bool setAndSave(PersistentSetting<T>& setting, long value)
+{
+    if (value < 0 || (long)(T)value != value || !setting.set((T)value)) {
+        return false;
+    }
+    setting.save();
+    return true;
+}
+
+uint32_t gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Returns true if the current settings make a workable schedule: the day
+// isn't empty (wake no later than sleep), and a spin and its delivery window
+// finish (in real time) before the next schedule trigger. Triggers fall on
+// multiples of Period1 and Period2, so the shortest gap between two of them
+// is gcd(Period1, Period2).
+bool scheduleFits()
+{
+    if (WakeSeconds.get() > SleepSeconds.get()) {
+        debugId();
+        DBLN(F("wake time is after sleep time"));
+        return false;
+    }
+
+    uint32_t spinMs = (MaxFullSpinSteps * 1000L / StepperNormalSpeed.get())
+                      + (StepperNormalSpeed.get() * 1000L / StepperNormalAcceleration.get())
+                      + SpinDeliveryBudgetMs;
+    uint32_t gapMs = gcd(Period1.get(), Period2.get()) * 1000L / TimeWarp.get();
+    if (gapMs < spinMs) {
+        debugId();
+        DBLN(F("no time to spin between triggers"));
+        return false;
+    }
+    return true;
+}
+
+// Like setAndSave, but also refuses (and restores the saved value) if the new
+// value would not make a workable schedule (see scheduleFits).
+template <class T>
+bool setAndSaveIfFits(PersistentSetting<T>& setting, long value)
+{
+    if (value < 0 || (long)(T)value != value || !setting.set((T)value)) {
+        return false;
+    }
+    if (!scheduleFits()) {
+        setting.load();
+        return false;
+    }
+    setting.save();
+    return true;
+}
+
+bool applyProfile(char profile)
+{
+    debugId();
+    DB(F("applyProfile "));
+    DBLN(profile);
+
+    switch (profile) {
+    case 'P':
+        setAndSave(StepperNormalSpeed, ProperStepperSpeed);
+        setAndSave(StepperNormalAcceleration, ProperStepperAcceleration);
+        setAndSave(TimeWarp, ProperTimeWarp);
+        break;
+    case 'T':
+        setAndSave(StepperNormalSpeed, TestingStepperSpeed);
+        setAndSave(StepperNormalAcceleration, TestingStepperAcceleration);
+        setAndSave(TimeWarp, TestingTimeWarp);
+        break;
+    default:
+        return false;
+    }
+
+    // Both profiles use the proper schedule - testing just runs it faster
+    setAndSave(Period1, ProperPeriod1);
+    setAndSave(Period2, ProperPeriod2);
+    setAndSave(WakeSeconds, ProperWakeSeconds);
+    setAndSave(SleepSeconds, ProperSleepSeconds);
+    Warping = false;
+    return true;
+}
+
+bool setSetting(char key, long value)
+{
+    debugId();
+    DB(F("setSetting "));
+    DB(key);
+    DB('=');
+    DBLN(value);
+
+    switch (key) {
+    case 'S': return setAndSaveIfFits(StepperNormalSpeed, value);
+    case 'A': return setAndSaveIfFits(StepperNormalAcceleration, value);
+    case '1': return setAndSaveIfFits(Period1, value);
+    case '2': return setAndSaveIfFits(Period2, value);
+    case 'W':
+        if (!setAndSaveIfFits(WakeSeconds, value)) return false;
+        Warping = false;
+        return true;
+    case 'Z': return setAndSaveIfFits(SleepSeconds, value);
+    case 'X':
+        if (!setAndSaveIfFits(TimeWarp, value)) return false;
+        Warping = false;
+        return true;
+    default:  return false;
+    }
+}
+
+void printSettings()
+{
+    Serial.print(F("HTL S="));
+    Serial.print(StepperNormalSpeed.get());
+    Serial.print(F(" A="));
+    Serial.print(StepperNormalAcceleration.get());
+    Serial.print(F(" 1="));
+    Serial.print(Period1.get());
+    Serial.print(F(" 2="));
+    Serial.print(Period2.get());
+    Serial.print(F(" W="));
+    Serial.print(WakeSeconds.get());
+    Serial.print(F(" Z="));
+    Serial.print(SleepSeconds.get());
+    Serial.print(F(" X="));
+    Serial.println(TimeWarp.get());
+}
+
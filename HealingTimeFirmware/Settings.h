@@ -0,0 +1,34 @@
+#pragma once
+
+#include "PersistentSetting.h"
+
+// Settings which may be changed at runtime with "HTV" commands (see
+// CmdReceiver.cpp). The key for each is given in brackets.
+extern PersistentSetting<uint16_t> StepperNormalSpeed;          // [S]
+extern PersistentSetting<uint16_t> StepperNormalAcceleration;   // [A]
+extern PersistentSetting<uint32_t> Period1;                     // [1]
+extern PersistentSetting<uint32_t> Period2;                     // [2]
+extern PersistentSetting<uint32_t> WakeSeconds;                 // [W]
+extern PersistentSetting<uint32_t> SleepSeconds;                // [Z]
+extern PersistentSetting<uint8_t> TimeWarp;                     // [X]
+
+// True while the Dom is running its schedule on the warped clock. Cleared
+// when the profile, time warp or wake time changes, so the warped day starts
+// again from the wake time.
+extern bool Warping;
+
+// Set and save every setting from a named profile:
+// 'P' - proper (production) values
+// 'T' - testing (commissioning) values: fast motors, schedule time warp
+// Returns false if the profile is not known.
+bool applyProfile(char profile);
+
+// Set and save the setting with the given key. Returns false if the key is
+// not known, the value is out of range, the wake time would be after the
+// sleep time, or the value would let the schedule trigger again before a
+// spin has had time to finish.
+bool setSetting(char key, long value);
+
+// Print the current settings to serial
+void printSettings();
+